@@ -0,0 +1,372 @@
+#include <string.h>
+#include "avl-batch.h"
+
+/*
+ * Returns 0 on success, -1 if the lock cannot be initialized.
+ */
+int avl_batch_tree_init(struct avl_batch_tree *tree, avl_batch_cmp_t cmp,
+                        void (*release)(struct avl_node *))
+{
+    tree->avl_root.avl_node = NULL;
+    tree->cmp = cmp;
+    tree->release = release;
+    return pthread_rwlock_init(&tree->lock, NULL) ? -1 : 0;
+}
+
+/* every batch must have been destroyed, the nodes are left to the caller */
+void avl_batch_tree_destroy(struct avl_batch_tree *tree)
+{
+    pthread_rwlock_destroy(&tree->lock);
+}
+
+/*
+ * Returns 0 on success, -1 if size is 0 or the buffer cannot be allocated.
+ */
+int avl_batch_init(struct avl_batch *batch, struct avl_batch_tree *tree,
+                   size_t size)
+{
+    if (size == 0)
+        return -1;
+    if ((batch->ops = malloc(size * sizeof(*batch->ops))) == NULL)
+        return -1;
+    batch->tree = tree;
+    batch->nr = 0;
+    batch->size = size;
+    return 0;
+}
+
+void avl_batch_destroy(struct avl_batch *batch)
+{
+    avl_batch_flush(batch);
+    free(batch->ops);
+    batch->ops = NULL;
+}
+
+static void avl_batch_release(struct avl_batch_tree *tree,
+                              struct avl_node *node)
+{
+    if (tree->release)
+        tree->release(node);
+}
+
+/*
+ * Binary search of the buffer: returns the index of the op for key, or where
+ * it belongs with *found cleared.
+ */
+static size_t avl_batch_find(const struct avl_batch *batch,
+                             const struct avl_node *key, int *found)
+{
+    size_t lo = 0, hi = batch->nr, mid;
+    int c;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        c = batch->tree->cmp(key, batch->ops[mid].node);
+        if (c == 0) {
+            *found = 1;
+            return mid;
+        }
+        if (c < 0)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    *found = 0;
+    return lo;
+}
+
+static void avl_batch_add(struct avl_batch *batch, struct avl_node *node, int op)
+{
+    struct avl_batch_op *ops = batch->ops;
+    size_t i;
+    int found;
+
+    i = avl_batch_find(batch, node, &found);
+    if (found) {
+        /* a second erase keeps the first probe */
+        if (op == AVL_BATCH_ERASE && ops[i].op == AVL_BATCH_ERASE) {
+            avl_batch_release(batch->tree, node);
+            return;
+        }
+        avl_batch_release(batch->tree, ops[i].node);
+    } else {
+        memmove(&ops[i + 1], &ops[i], (batch->nr - i) * sizeof(*ops));
+        batch->nr++;
+    }
+    ops[i].node = node;
+    ops[i].op = op;
+
+    if (batch->nr == batch->size)
+        avl_batch_flush(batch);
+}
+
+void avl_batch_insert(struct avl_batch *batch, struct avl_node *node)
+{
+    /* avl_replace_node() keeps the AVL_DEAD flag node comes with */
+    avl_init_node(node);
+    avl_batch_add(batch, node, AVL_BATCH_INSERT);
+}
+
+void avl_batch_erase(struct avl_batch *batch, struct avl_node *key)
+{
+    avl_batch_add(batch, key, AVL_BATCH_ERASE);
+}
+
+struct avl_node *avl_batch_search(struct avl_batch *batch,
+                                  const struct avl_node *key)
+{
+    struct avl_batch_tree *tree = batch->tree;
+    struct avl_node *node;
+    size_t i;
+    int found, c;
+
+    i = avl_batch_find(batch, key, &found);
+    if (found)
+        return batch->ops[i].op == AVL_BATCH_INSERT ? batch->ops[i].node : NULL;
+
+    pthread_rwlock_rdlock(&tree->lock);
+    node = tree->avl_root.avl_node;
+    while (node && (c = tree->cmp(key, node)) != 0)
+        node = c < 0 ? node->avl_left : node->avl_right;
+    pthread_rwlock_unlock(&tree->lock);
+
+    return node;
+}
+
+/*
+ * Find the link of key starting from finger, a node not greater than key (or
+ * NULL to start from the root): climb until key falls inside the subtree,
+ * then descend. Keys come in increasing order, so a whole merge visits each
+ * part of the tree about once.
+ */
+static struct avl_node **avl_batch_link(struct avl_batch_tree *tree,
+        struct avl_node *finger, const struct avl_node *key,
+        struct avl_node **parent)
+{
+    struct avl_node **link = &tree->avl_root.avl_node, *node, *p = NULL;
+    int c;
+
+    if (finger) {
+        node = finger;
+        /* a right child's parent is smaller than finger, so than key too */
+        while ((p = avl_parent(node)) &&
+               (node == p->avl_right || tree->cmp(key, p) >= 0))
+            node = p;
+        if (p)
+            link = &p->avl_left;
+    }
+
+    *parent = p;
+    while ((node = *link) != NULL) {
+        if ((c = tree->cmp(key, node)) == 0)
+            break;
+        *parent = node;
+        link = c < 0 ? &node->avl_left : &node->avl_right;
+    }
+
+    return link;
+}
+
+/* height of an AVL subtree, following the taller side down */
+static int avl_batch_height(const struct avl_node *node)
+{
+    int h = 0;
+
+    for (; node; h++)
+        node = avl_is_right_heavy(node) ? node->avl_right : node->avl_left;
+    return h;
+}
+
+/* height of the subtree avl_batch_build() makes out of n nodes */
+static int avl_batch_run_height(size_t n)
+{
+    int h = 0;
+
+    for (; n; n >>= 1)
+        h++;
+    return h;
+}
+
+/*
+ * Link ops[lo, hi) into a perfectly balanced subtree under parent, without
+ * rotations. Returns its root.
+ */
+static struct avl_node *avl_batch_build(struct avl_batch_op *ops, size_t lo,
+        size_t hi, struct avl_node *parent)
+{
+    struct avl_node *node;
+    size_t mid;
+
+    if (lo == hi)
+        return NULL;
+    mid = lo + (hi - lo) / 2;
+    node = ops[mid].node;
+    node->avl_parent_balance = (unsigned long)parent;
+    node->avl_left = avl_batch_build(ops, lo, mid, node);
+    node->avl_right = avl_batch_build(ops, mid + 1, hi, node);
+    if (avl_batch_run_height(mid - lo) > avl_batch_run_height(hi - mid - 1))
+        avl_set_balance(node, AVL_LEFT_HEAVY);
+
+    return node;
+}
+
+/*
+ * node, at *link, has AVL subtrees of heights lh and rh. Set its balance,
+ * or if they differ by more than one, hang node with the lower subtree on
+ * the spine of the higher one where heights match, and let the insert
+ * fixup climb back up that spine only. Returns the new height.
+ */
+static int avl_batch_join(struct avl_node **link, struct avl_node *node,
+                          int lh, int rh)
+{
+    struct avl_node *parent = avl_parent(node), *top, *c, *cp = NULL;
+    struct avl_root sub;
+    int h;
+
+    if (lh - rh <= 1 && rh - lh <= 1) {
+        avl_set_balance(node, lh > rh ? AVL_LEFT_HEAVY :
+                              lh < rh ? AVL_RIGHT_HEAVY : AVL_BALANCED);
+        return (lh > rh ? lh : rh) + 1;
+    }
+
+    if (lh > rh) {
+        top = node->avl_left;
+        for (c = top, h = lh; h > rh + 1; c = c->avl_right) {
+            h -= avl_is_left_heavy(c) ? 2 : 1;
+            cp = c;
+        }
+        node->avl_left = c;
+        avl_set_balance(node, h > rh ? AVL_LEFT_HEAVY : AVL_BALANCED);
+        cp->avl_right = node;
+    } else {
+        top = node->avl_right;
+        for (c = top, h = rh; h > lh + 1; c = c->avl_left) {
+            h -= avl_is_right_heavy(c) ? 2 : 1;
+            cp = c;
+        }
+        node->avl_right = c;
+        avl_set_balance(node, h > lh ? AVL_RIGHT_HEAVY : AVL_BALANCED);
+        cp->avl_left = node;
+    }
+    if (c)
+        avl_set_parent(c, node);
+    avl_set_parent(node, cp);
+
+    /* node is one taller than c was: an insert as seen from cp */
+    avl_set_parent(top, NULL);
+    sub.avl_node = top;
+    avl_insert_balance(node, &sub);
+    top = sub.avl_node;
+    avl_set_parent(top, parent);
+    *link = top;
+
+    return avl_batch_height(top);
+}
+
+/*
+ * Restore balance below *link, whose subtree was height tall before
+ * ops[lo, hi) were linked into it. Only subtrees that got new nodes are
+ * visited, children first. Returns the new height.
+ */
+static int avl_batch_fix(struct avl_batch_tree *tree, struct avl_node **link,
+        int height, struct avl_batch_op *ops, size_t lo, size_t hi)
+{
+    struct avl_node *node = *link;
+    size_t mid, l = lo, r = hi;
+    int lh, rh;
+
+    if (lo == hi)
+        return height;
+    if (height == 0)
+        return avl_batch_run_height(hi - lo);
+
+    /* new keys below node split around it */
+    while (l < r) {
+        mid = l + (r - l) / 2;
+        if (tree->cmp(ops[mid].node, node) < 0)
+            l = mid + 1;
+        else
+            r = mid;
+    }
+    lh = height - (avl_is_right_heavy(node) ? 2 : 1);
+    rh = height - (avl_is_left_heavy(node) ? 2 : 1);
+    lh = avl_batch_fix(tree, &node->avl_left, lh, ops, lo, l);
+    rh = avl_batch_fix(tree, &node->avl_right, rh, ops, l, hi);
+
+    return avl_batch_join(link, node, lh, rh);
+}
+
+/*
+ * Merge the sorted new keys ops[0, n) into the tree: each run of keys that
+ * falls into the same empty link is linked there as a balanced subtree,
+ * then a single bottom-up pass over the touched paths restores balance.
+ */
+static void avl_batch_merge(struct avl_batch_tree *tree,
+                            struct avl_batch_op *ops, size_t n)
+{
+    struct avl_node **link, *parent, *bound, *finger = NULL;
+    int height = avl_batch_height(tree->avl_root.avl_node);
+    size_t i, j;
+
+    for (i = 0; i < n; i = j) {
+        link = avl_batch_link(tree, finger, ops[i].node, &parent);
+        /* the run ends at the next node of the tree */
+        if (!parent)
+            bound = NULL;
+        else if (link == &parent->avl_left)
+            bound = parent;
+        else
+            bound = avl_next(parent);
+        for (j = i + 1; j < n; j++)
+            if (bound && tree->cmp(ops[j].node, bound) > 0)
+                break;
+        *link = avl_batch_build(ops, i, j, parent);
+        finger = ops[j - 1].node;
+    }
+
+    avl_batch_fix(tree, &tree->avl_root.avl_node, height, ops, 0, n);
+}
+
+void avl_batch_flush(struct avl_batch *batch)
+{
+    struct avl_batch_tree *tree = batch->tree;
+    struct avl_batch_op *ops = batch->ops;
+    struct avl_node **link, *parent, *node, *old, *finger = NULL;
+    size_t i, n = 0;
+
+    if (!batch->nr)
+        return;
+
+    pthread_rwlock_wrlock(&tree->lock);
+    /*
+     * Replacements and erases first, while balance factors are exact. New
+     * keys are moved to the front of ops for avl_batch_merge().
+     */
+    for (i = 0; i < batch->nr; i++) {
+        node = ops[i].node;
+        link = avl_batch_link(tree, finger, node, &parent);
+        old = *link;
+
+        if (ops[i].op == AVL_BATCH_INSERT) {
+            if (old) {
+                avl_replace_node(old, node, &tree->avl_root);
+                avl_batch_release(tree, old);
+                finger = node;
+            } else {
+                ops[n++].node = node;
+            }
+        } else {
+            if (old) {
+                finger = avl_prev(old);
+                avl_erase(old, &tree->avl_root);
+                avl_batch_release(tree, old);
+            }
+            avl_batch_release(tree, node);
+        }
+    }
+    if (n)
+        avl_batch_merge(tree, ops, n);
+    pthread_rwlock_unlock(&tree->lock);
+
+    batch->nr = 0;
+}
@@ -0,0 +1,71 @@
+#ifndef AVL_BATCH_H
+#define AVL_BATCH_H
+
+#include <pthread.h>
+#include "avl-tree.h"
+
+/*
+ * Write combining in front of a shared tree: each writer thread owns a
+ * struct avl_batch, a small array of pending inserts and erases sorted by
+ * key with at most one operation per key. When it fills up (or on
+ * avl_batch_flush()) it is merged into the tree under one write lock. The
+ * merge walks the tree in key order from the last touched node instead of
+ * descending from the root for every key. Each run of new keys that falls
+ * into the same empty link is linked there as a balanced subtree, then a
+ * single bottom-up pass over the touched paths restores balance, joining
+ * subtrees whose heights grew apart.
+ *
+ * Inserts replace a node of an equal key. Erases take a probe node that
+ * only has to carry the key. Replaced nodes, erased nodes and probes are
+ * handed to release() once nothing refers to them anymore, if it is not
+ * NULL.
+ *
+ * Lookups that miss the caller's batch only take the tree lock for reading,
+ * so they run in parallel with each other and wait only for merges.
+ *
+ * avl_batch_search() sees the writes of its own batch, writes buffered by
+ * other threads only become visible when those are flushed. A node it
+ * returns from the tree may be released by another thread's flush at any
+ * time, keeping it alive is up to the caller.
+ */
+
+typedef int (*avl_batch_cmp_t)(const struct avl_node *a,
+                               const struct avl_node *b);
+
+struct avl_batch_tree {
+    struct avl_root avl_root;
+    pthread_rwlock_t lock;      /* read for lookups, write for merges */
+    avl_batch_cmp_t cmp;
+    void (*release)(struct avl_node *);
+};
+
+#define AVL_BATCH_INSERT 0
+#define AVL_BATCH_ERASE 1
+
+struct avl_batch_op {
+    struct avl_node *node;
+    int op;
+};
+
+struct avl_batch {
+    struct avl_batch_tree *tree;
+    struct avl_batch_op *ops;
+    size_t nr, size;
+};
+
+#define AVL_BATCH_DEFAULT_SIZE 64
+
+extern int avl_batch_tree_init(struct avl_batch_tree *, avl_batch_cmp_t cmp,
+                               void (*release)(struct avl_node *));
+extern void avl_batch_tree_destroy(struct avl_batch_tree *);
+
+extern int avl_batch_init(struct avl_batch *, struct avl_batch_tree *,
+                          size_t size);
+extern void avl_batch_destroy(struct avl_batch *);
+extern void avl_batch_insert(struct avl_batch *, struct avl_node *);
+extern void avl_batch_erase(struct avl_batch *, struct avl_node *key);
+extern struct avl_node *avl_batch_search(struct avl_batch *,
+                                         const struct avl_node *key);
+extern void avl_batch_flush(struct avl_batch *);
+
+#endif
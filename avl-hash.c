@@ -0,0 +1,190 @@
+#include "avl-hash.h"
+
+/* a slot of the old table whose node has been moved or erased */
+#define AVL_HASH_MOVED ((struct avl_node *)1)
+
+static int avl_hash_table_alloc(struct avl_hash_table *t, size_t size)
+{
+    if ((t->slots = calloc(size, sizeof(*t->slots))) == NULL)
+        return -1;
+    t->mask = size - 1;
+    t->nr = 0;
+    return 0;
+}
+
+/*
+ * Returns 0 on success, -1 if the table cannot be allocated. size is rounded
+ * up to a power of two.
+ */
+int avl_hash_init(struct avl_hash *h, size_t size)
+{
+    size_t n = 1;
+
+    while (n < size)
+        n <<= 1;
+    h->old.slots = NULL;
+    h->old.mask = h->old.nr = 0;
+    h->migrated = 0;
+    return avl_hash_table_alloc(&h->cur, n);
+}
+
+void avl_hash_destroy(struct avl_hash *h)
+{
+    free(h->cur.slots);
+    free(h->old.slots);
+    h->cur.slots = h->old.slots = NULL;
+}
+
+static void avl_hash_put(struct avl_hash_table *t, struct avl_node *node,
+                         unsigned long hash)
+{
+    size_t i = hash & t->mask;
+
+    while (t->slots[i].node)
+        i = (i + 1) & t->mask;
+    t->slots[i].hash = hash;
+    t->slots[i].node = node;
+    t->nr++;
+}
+
+static struct avl_hash_slot *avl_hash_find_node(const struct avl_hash_table *t,
+        const struct avl_node *node, unsigned long hash)
+{
+    size_t i = hash & t->mask;
+
+    for (; t->slots[i].node; i = (i + 1) & t->mask)
+        if (t->slots[i].node == node)
+            return &t->slots[i];
+    return NULL;
+}
+
+/*
+ * Free slot i, shifting back later entries of the chain that may live
+ * there, so that lookups can still stop at the first free slot.
+ */
+static void avl_hash_del(struct avl_hash_table *t, size_t i)
+{
+    size_t j = i, home;
+
+    for (;;) {
+        j = (j + 1) & t->mask;
+        if (!t->slots[j].node)
+            break;
+        home = t->slots[j].hash & t->mask;
+        /* hole is between home and j: entry may move into it */
+        if (((j - home) & t->mask) >= ((j - i) & t->mask)) {
+            t->slots[i] = t->slots[j];
+            i = j;
+        }
+    }
+    t->slots[i].node = NULL;
+    t->nr--;
+}
+
+static void avl_hash_migrate(struct avl_hash *h, size_t budget)
+{
+    struct avl_hash_slot *slot;
+
+    for (; h->old.slots && budget; budget--) {
+        slot = &h->old.slots[h->migrated];
+        if (slot->node && slot->node != AVL_HASH_MOVED) {
+            avl_hash_put(&h->cur, slot->node, slot->hash);
+            /* still not free: lookups in old must go on probing past it */
+            slot->node = AVL_HASH_MOVED;
+            h->old.nr--;
+        }
+        if (++h->migrated > h->old.mask) {
+            free(h->old.slots);
+            h->old.slots = NULL;
+            h->old.mask = h->old.nr = 0;
+        }
+    }
+}
+
+/*
+ * Returns 0 on success, -1 if the table is full and cannot grow.
+ */
+int avl_hash_insert(struct avl_hash *h, struct avl_node *node,
+                    unsigned long hash)
+{
+    struct avl_hash_table new;
+
+    avl_hash_migrate(h, AVL_HASH_MIGRATE_STEP);
+
+    /* keep the load factor under 3/4 */
+    if ((h->cur.nr + h->old.nr + 1) * 4 > (h->cur.mask + 1) * 3) {
+        if (h->old.slots)
+            avl_hash_migrate(h, h->old.mask + 1 - h->migrated);
+        if (avl_hash_table_alloc(&new, (h->cur.mask + 1) * 2) == -1) {
+            if (h->cur.nr == h->cur.mask)
+                return -1;
+        } else {
+            h->old = h->cur;
+            h->cur = new;
+            h->migrated = 0;
+        }
+    }
+
+    avl_hash_put(&h->cur, node, hash);
+    return 0;
+}
+
+void avl_hash_erase(struct avl_hash *h, struct avl_node *node,
+                    unsigned long hash)
+{
+    struct avl_hash_slot *slot;
+
+    if ((slot = avl_hash_find_node(&h->cur, node, hash)) != NULL) {
+        avl_hash_del(&h->cur, slot - h->cur.slots);
+    } else if (h->old.slots &&
+               (slot = avl_hash_find_node(&h->old, node, hash)) != NULL) {
+        slot->node = AVL_HASH_MOVED;
+        h->old.nr--;
+    }
+
+    avl_hash_migrate(h, AVL_HASH_MIGRATE_STEP);
+}
+
+static struct avl_node *avl_hash_table_lookup(const struct avl_hash_table *t,
+        unsigned long hash, const void *key, avl_hash_eq_t eq)
+{
+    size_t i = hash & t->mask;
+    struct avl_node *node;
+
+    for (; (node = t->slots[i].node) != NULL; i = (i + 1) & t->mask)
+        if (t->slots[i].hash == hash && node != AVL_HASH_MOVED && eq(node, key))
+            return node;
+    return NULL;
+}
+
+struct avl_node *avl_hash_lookup(const struct avl_hash *h, unsigned long hash,
+                                 const void *key, avl_hash_eq_t eq)
+{
+    struct avl_node *node;
+
+    node = avl_hash_table_lookup(&h->cur, hash, key, eq);
+    if (!node && h->old.slots)
+        node = avl_hash_table_lookup(&h->old, hash, key, eq);
+    return node;
+}
+
+/*
+ * Rebalance after avl_link_node() and index node. Returns 0 on success, -1
+ * if the index cannot grow, node is then unlinked again.
+ */
+int avl_hinsert_balance(struct avl_node *node, unsigned long hash,
+                        struct avl_hroot *hroot)
+{
+    avl_insert_balance(node, &hroot->avl_root);
+    if (avl_hash_insert(&hroot->avl_hash, node, hash) == 0)
+        return 0;
+    avl_erase(node, &hroot->avl_root);
+    return -1;
+}
+
+void avl_herase(struct avl_node *node, unsigned long hash,
+                struct avl_hroot *hroot)
+{
+    avl_hash_erase(&hroot->avl_hash, node, hash);
+    avl_erase(node, &hroot->avl_root);
+}
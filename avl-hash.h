@@ -0,0 +1,71 @@
+#ifndef AVL_HASH_H
+#define AVL_HASH_H
+
+#include "avl-tree.h"
+
+/*
+ * Open addressing index from key hashes to tree nodes, for exact-match
+ * lookups that should not pay for a tree descent. Slots keep the full hash
+ * next to the node pointer, so probing and rehashing never touch the nodes
+ * and four slots share a cache line on 64-bit. Linear probing with
+ * backward-shift deletion keeps chains short without tombstones.
+ *
+ * Growing is incremental: the full table is kept as old and every insert
+ * or erase moves AVL_HASH_MIGRATE_STEP of its slots into the new one, so
+ * no single operation pays for a whole rehash. Lookups check both tables
+ * and never move anything.
+ *
+ * struct avl_hroot bundles the index with its tree; avl_hinsert_balance()
+ * and avl_herase() keep the two in sync, ordered walks and range queries
+ * still go through avl_root.
+ */
+
+struct avl_hash_slot {
+    unsigned long hash;
+    struct avl_node *node;      /* NULL when free */
+};
+
+struct avl_hash_table {
+    struct avl_hash_slot *slots;
+    size_t mask;                /* number of slots - 1 */
+    size_t nr;
+};
+
+struct avl_hash {
+    struct avl_hash_table cur;
+    struct avl_hash_table old;  /* being moved into cur, no slots when idle */
+    size_t migrated;            /* old slots moved so far */
+};
+
+struct avl_hroot {
+    struct avl_root avl_root;
+    struct avl_hash avl_hash;
+};
+
+#define AVL_HASH_DEFAULT_SIZE 64
+#define AVL_HASH_MIGRATE_STEP 8
+
+/* nonzero if node holds key, only called on a full hash match */
+typedef int (*avl_hash_eq_t)(const struct avl_node *node, const void *key);
+
+extern int avl_hash_init(struct avl_hash *, size_t size);
+extern void avl_hash_destroy(struct avl_hash *);
+extern int avl_hash_insert(struct avl_hash *, struct avl_node *,
+                           unsigned long hash);
+extern void avl_hash_erase(struct avl_hash *, struct avl_node *,
+                           unsigned long hash);
+extern struct avl_node *avl_hash_lookup(const struct avl_hash *,
+        unsigned long hash, const void *key, avl_hash_eq_t eq);
+
+static inline int avl_hroot_init(struct avl_hroot *hroot, size_t size)
+{
+    hroot->avl_root.avl_node = NULL;
+    return avl_hash_init(&hroot->avl_hash, size);
+}
+
+extern int avl_hinsert_balance(struct avl_node *, unsigned long hash,
+                               struct avl_hroot *);
+extern void avl_herase(struct avl_node *, unsigned long hash,
+                       struct avl_hroot *);
+
+#endif
@@ -227,6 +227,7 @@ void avl_erase_balance(struct avl_node *node, struct avl_node *parent, struct av
 void avl_erase(struct avl_node *node, struct avl_root *root)
 {
     struct avl_node *parent, *child, *old, *tmp;
+    unsigned long dead;
 
     if (!node->avl_left) {
         child = node->avl_right;
@@ -260,7 +261,9 @@ void avl_erase(struct avl_node *node, struct avl_root *root)
             root->avl_node = node;
         tmp = old->avl_left;
         avl_set_parent(tmp, node);
+        dead = avl_is_dead(node);
         *node = *old;
+        node->avl_parent_balance = (node->avl_parent_balance & ~AVL_DEAD) | dead;
         goto balance;
     }
 
@@ -288,3 +291,303 @@ balance:
     }
 }
 
+
+/*
+ * Put new in the place of victim without rebalancing; new takes over the
+ * children and balance of victim but keeps its own AVL_DEAD flag.
+ */
+void avl_replace_node(struct avl_node *victim, struct avl_node *new,
+                      struct avl_root *root)
+{
+    struct avl_node *parent = avl_parent(victim);
+    unsigned long dead;
+
+    if (parent) {
+        if (victim == parent->avl_left)
+            parent->avl_left = new;
+        else
+            parent->avl_right = new;
+    } else {
+        root->avl_node = new;
+    }
+    if (victim->avl_left)
+        avl_set_parent(victim->avl_left, new);
+    if (victim->avl_right)
+        avl_set_parent(victim->avl_right, new);
+    dead = avl_is_dead(new);
+    *new = *victim;
+    new->avl_parent_balance = (new->avl_parent_balance & ~AVL_DEAD) | dead;
+}
+
+void avl_multi_erase(struct avl_multi_node *node, struct avl_root *root)
+{
+    struct avl_multi_node *next = node->avl_dup_next;
+
+    if (next == node) {
+        /* last entry of its key */
+        avl_erase(&node->avl_node, root);
+        return;
+    }
+
+    next->avl_dup_prev = node->avl_dup_prev;
+    node->avl_dup_prev->avl_dup_next = next;
+    /* the oldest duplicate takes over the tree position */
+    if (!avl_is_duplicate(&node->avl_node))
+        avl_replace_node(&node->avl_node, &next->avl_node, root);
+}
+
+struct avl_node *avl_first(const struct avl_root *root)
+{
+    struct avl_node *node = root->avl_node;
+
+    if (!node)
+        return NULL;
+    while (node->avl_left)
+        node = node->avl_left;
+    return node;
+}
+
+struct avl_node *avl_last(const struct avl_root *root)
+{
+    struct avl_node *node = root->avl_node;
+
+    if (!node)
+        return NULL;
+    while (node->avl_right)
+        node = node->avl_right;
+    return node;
+}
+
+struct avl_node *avl_next(const struct avl_node *node)
+{
+    struct avl_node *parent;
+
+    if (node->avl_right) {
+        node = node->avl_right;
+        while (node->avl_left)
+            node = node->avl_left;
+        return (struct avl_node *)node;
+    }
+    /* go up until we come from a left child */
+    while ((parent = avl_parent(node)) && node == parent->avl_right)
+        node = parent;
+    return parent;
+}
+
+struct avl_node *avl_prev(const struct avl_node *node)
+{
+    struct avl_node *parent;
+
+    if (node->avl_left) {
+        node = node->avl_left;
+        while (node->avl_right)
+            node = node->avl_right;
+        return (struct avl_node *)node;
+    }
+    while ((parent = avl_parent(node)) && node == parent->avl_left)
+        node = parent;
+    return parent;
+}
+
+void avl_lazy_insert_balance(struct avl_node *node, struct avl_lazy_root *lroot)
+{
+    lroot->nr_nodes++;
+    avl_insert_balance(node, &lroot->avl_root);
+    if (lroot->cursor)
+        avl_lazy_compact_step(lroot, lroot->step_budget);
+}
+
+void avl_lazy_erase(struct avl_node *node, struct avl_lazy_root *lroot)
+{
+    if (avl_is_dead(node))
+        return;
+    avl_set_dead(node);
+    lroot->nr_dead++;
+
+    if (lroot->nr_dead * 100 >= lroot->nr_nodes * lroot->dead_ratio)
+        avl_lazy_compact_start(lroot);
+    if (lroot->cursor)
+        avl_lazy_compact_step(lroot, lroot->step_budget);
+}
+
+/*
+ * Start a compaction pass now, e.g. at a quiet point, whatever the dead
+ * ratio. Does nothing if a pass is running or no node is dead. Returns
+ * nonzero if a pass is running afterwards.
+ */
+int avl_lazy_compact_start(struct avl_lazy_root *lroot)
+{
+    if (!lroot->cursor && lroot->nr_dead)
+        lroot->cursor = avl_first(&lroot->avl_root);
+    return lroot->cursor != NULL;
+}
+
+/*
+ * Erase at most budget dead nodes of the running compaction pass, visiting
+ * at most AVL_LAZY_SCAN_RATIO nodes per erase allowed. A budget of 0 counts
+ * as 1, so a step always makes progress. Returns nonzero while the pass is
+ * not finished.
+ */
+int avl_lazy_compact_step(struct avl_lazy_root *lroot, unsigned int budget)
+{
+    struct avl_node *node = lroot->cursor, *next;
+    unsigned long scan;
+
+    if (!budget)
+        budget = 1;
+    scan = (unsigned long)budget * AVL_LAZY_SCAN_RATIO;
+
+    for (; node && budget && scan; node = next, scan--) {
+        if (!lroot->nr_dead) {
+            node = NULL;
+            break;
+        }
+        /* avl_erase() keeps the successor node valid */
+        next = avl_next(node);
+        if (avl_is_dead(node)) {
+            avl_erase(node, &lroot->avl_root);
+            lroot->nr_nodes--;
+            lroot->nr_dead--;
+            budget--;
+            if (lroot->release)
+                lroot->release(node);
+        }
+    }
+    lroot->cursor = node;
+
+    return node != NULL;
+}
+
+struct avl_node *avl_lazy_first(const struct avl_lazy_root *lroot)
+{
+    struct avl_node *node = avl_first(&lroot->avl_root);
+
+    while (node && avl_is_dead(node))
+        node = avl_next(node);
+    return node;
+}
+
+struct avl_node *avl_lazy_next(const struct avl_node *node)
+{
+    while ((node = avl_next(node)) && avl_is_dead(node))
+        ;
+    return (struct avl_node *)node;
+}
+
+/*
+ * Returns 0 on success, -1 if size is 0 or the rings cannot be allocated.
+ */
+int avl_relaxed_init(struct avl_relaxed_root *rroot, size_t size,
+                     void (*release)(struct avl_node *))
+{
+    if (size == 0)
+        return -1;
+    rroot->avl_root.avl_node = NULL;
+    rroot->inserted = malloc(size * sizeof(*rroot->inserted));
+    rroot->erased = malloc(size * sizeof(*rroot->erased));
+    if (!rroot->inserted || !rroot->erased) {
+        free(rroot->inserted);
+        free(rroot->erased);
+        return -1;
+    }
+    rroot->size = size;
+    rroot->ins_head = rroot->nr_inserted = 0;
+    rroot->era_head = rroot->nr_erased = 0;
+    rroot->release = release;
+    return 0;
+}
+
+/* frees the rings only, pending work is dropped */
+void avl_relaxed_destroy(struct avl_relaxed_root *rroot)
+{
+    free(rroot->inserted);
+    free(rroot->erased);
+    rroot->inserted = rroot->erased = NULL;
+    rroot->nr_inserted = rroot->nr_erased = 0;
+}
+
+/* node has been linked with avl_link_node() */
+void avl_relaxed_insert(struct avl_node *node, struct avl_relaxed_root *rroot)
+{
+    if (rroot->nr_inserted == rroot->size)
+        avl_rebalance_step(rroot, 1);
+    rroot->inserted[(rroot->ins_head + rroot->nr_inserted++) % rroot->size] = node;
+}
+
+void avl_relaxed_erase(struct avl_node *node, struct avl_relaxed_root *rroot)
+{
+    if (avl_is_dead(node))
+        return;
+    /* the oldest erase only runs once every insert is balanced */
+    if (rroot->nr_erased == rroot->size)
+        avl_rebalance_step(rroot, rroot->nr_inserted + 1);
+    avl_set_dead(node);
+    rroot->erased[(rroot->era_head + rroot->nr_erased++) % rroot->size] = node;
+}
+
+/*
+ * Do at most budget pending operations, returns how many are left.
+ */
+size_t avl_rebalance_step(struct avl_relaxed_root *rroot, size_t budget)
+{
+    struct avl_node *node;
+
+    for (; budget; budget--) {
+        if (rroot->nr_inserted) {
+            node = rroot->inserted[rroot->ins_head];
+            rroot->ins_head = (rroot->ins_head + 1) % rroot->size;
+            rroot->nr_inserted--;
+            /*
+             * Everything linked before node is balanced, everything
+             * after it hangs below balanced nodes' empty links: node is
+             * a leaf as far as the balance factors know.
+             */
+            avl_insert_balance(node, &rroot->avl_root);
+        } else if (rroot->nr_erased) {
+            node = rroot->erased[rroot->era_head];
+            rroot->era_head = (rroot->era_head + 1) % rroot->size;
+            rroot->nr_erased--;
+            avl_erase(node, &rroot->avl_root);
+            if (rroot->release)
+                rroot->release(node);
+        } else {
+            break;
+        }
+    }
+
+    return avl_relaxed_pending(rroot);
+}
+
+/*
+ * Find where key lives or would be linked: returns the link pointing to the
+ * node of an equal key, or the empty link to pass to avl_link_node() along
+ * with *parent.
+ */
+struct avl_node **avl_prefix_link(struct avl_root *root, uint64_t prefix,
+        const void *key, avl_prefix_cmp_t cmp, struct avl_node **parent)
+{
+    struct avl_node **link = &root->avl_node, *node;
+    struct avl_prefix_node *pnode;
+    int c;
+
+    *parent = NULL;
+    while ((node = *link) != NULL) {
+        pnode = avl_prefix_entry(node);
+        c = avl_prefix_cmp(prefix, pnode->avl_prefix);
+        if (!c && !(c = cmp(key, pnode)))
+            break;
+        *parent = node;
+        link = c < 0 ? &node->avl_left : &node->avl_right;
+    }
+
+    return link;
+}
+
+struct avl_prefix_node *avl_prefix_search(struct avl_root *root,
+        uint64_t prefix, const void *key, avl_prefix_cmp_t cmp)
+{
+    struct avl_node *parent, *node;
+
+    node = *avl_prefix_link(root, prefix, key, cmp, &parent);
+    return node ? avl_prefix_entry(node) : NULL;
+}
@@ -3,31 +3,39 @@
 
 #include <stddef.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 
 struct avl_node {
     unsigned long avl_parent_balance;
 #define AVL_BALANCED 0
 #define AVL_LEFT_HEAVY 1
 #define AVL_RIGHT_HEAVY 2
+#define AVL_DUPLICATE 3 /* not in the tree, chained off an equal key */
+#define AVL_DEAD 4 /* flag: erased lazily, see avl_lazy_root */
     struct avl_node *avl_right;
     struct avl_node *avl_left;
-} __attribute__((aligned(sizeof(long))));
+} __attribute__((aligned(8)));
 
 struct avl_root {
     struct avl_node *avl_node;
 };
 
-#define avl_parent(a) ((struct avl_node *)((a)->avl_parent_balance & ~3))
+#define avl_parent(a) ((struct avl_node *)((a)->avl_parent_balance & ~7))
 #define avl_balance(a) ((a)->avl_parent_balance & 3)
 #define avl_is_balanced(a) (!avl_balance(a))
 #define avl_is_left_heavy(a) (avl_balance(a) == AVL_LEFT_HEAVY)
 #define avl_is_right_heavy(a) (avl_balance(a) == AVL_RIGHT_HEAVY)
+#define avl_is_duplicate(a) (avl_balance(a) == AVL_DUPLICATE)
 #define avl_set_parent(a, p) \
-    ( (a)->avl_parent_balance = ((a)->avl_parent_balance & 3) \
+    ( (a)->avl_parent_balance = ((a)->avl_parent_balance & 7) \
                                 | ((unsigned long)(p)) )
 #define avl_set_balance(a, b) \
     ( (a)->avl_parent_balance = ((a)->avl_parent_balance & ~3) \
                                 | (b))
+#define avl_is_dead(a) ((a)->avl_parent_balance & AVL_DEAD)
+#define avl_set_dead(a) ((a)->avl_parent_balance |= AVL_DEAD)
+#define avl_clear_dead(a) ((a)->avl_parent_balance &= ~AVL_DEAD)
 
 #define container_of(ptr, type, member) \
     ((type *) ((char *)ptr - offsetof(type, member)))
@@ -52,6 +60,189 @@ static inline void avl_link_node(struct avl_node *node,
 extern void avl_insert_balance(struct avl_node *, struct avl_root *);
 void avl_erase_balance(struct avl_node *node, struct avl_node *parent, struct avl_root *root);
 extern void avl_erase(struct avl_node *, struct avl_root *);
+extern void avl_replace_node(struct avl_node *victim, struct avl_node *new,
+                             struct avl_root *root);
+extern struct avl_node *avl_first(const struct avl_root *);
+extern struct avl_node *avl_last(const struct avl_root *);
+extern struct avl_node *avl_next(const struct avl_node *);
+extern struct avl_node *avl_prev(const struct avl_node *);
+
+/*
+ * Multimap support: only the first entry of a key is linked into the tree,
+ * later entries with an equal key are chained off it in a circular list.
+ * Adding or removing a duplicate is O(1) and never rebalances, and the tree
+ * height depends on the number of distinct keys only.
+ */
+struct avl_multi_node {
+    struct avl_node avl_node;
+    struct avl_multi_node *avl_dup_next;
+    struct avl_multi_node *avl_dup_prev;
+};
+
+#define avl_multi_entry(ptr) container_of(ptr, struct avl_multi_node, avl_node)
+
+/* walk every entry equal to the tree node head, in insertion order */
+#define avl_multi_for_each(pos, head) \
+    for ((pos) = (head); (pos); \
+         (pos) = (pos)->avl_dup_next == (head) ? NULL : (pos)->avl_dup_next)
+
+static inline void avl_multi_link_node(struct avl_multi_node *node,
+        struct avl_node *parent, struct avl_node **avl_link)
+{
+    avl_link_node(&node->avl_node, parent, avl_link);
+    node->avl_dup_next = node->avl_dup_prev = node;
+}
+
+/* chain node behind head, head being the tree node found for an equal key */
+static inline void avl_multi_add_dup(struct avl_multi_node *node,
+        struct avl_multi_node *head)
+{
+    node->avl_node.avl_parent_balance = AVL_DUPLICATE;
+    node->avl_node.avl_left = node->avl_node.avl_right = NULL;
+
+    node->avl_dup_next = head;
+    node->avl_dup_prev = head->avl_dup_prev;
+    head->avl_dup_prev->avl_dup_next = node;
+    head->avl_dup_prev = node;
+}
+
+extern void avl_multi_erase(struct avl_multi_node *, struct avl_root *);
+
+/*
+ * Lazy deletion: avl_lazy_erase() only marks a node AVL_DEAD. Lookups must
+ * treat dead nodes as absent (an insert meeting a dead node of its key may
+ * avl_lazy_revive() it instead). Once dead nodes reach dead_ratio percent
+ * of the tree, a compaction pass starts and every following lazy operation
+ * erases at most step_budget dead nodes for real, handing them to release(),
+ * and visits at most AVL_LAZY_SCAN_RATIO nodes, dead or live, per erase
+ * allowed. A step_budget of 0 counts as 1. A budget above one erase per
+ * operation is enough for compaction to outrun lazy erases. Nodes of a lazy
+ * tree must not be avl_erase()d directly while a compaction is running.
+ */
+struct avl_lazy_root {
+    struct avl_root avl_root;
+    unsigned long nr_nodes;     /* linked nodes, dead ones included */
+    unsigned long nr_dead;
+    unsigned int dead_ratio;
+    unsigned int step_budget;
+    struct avl_node *cursor;    /* next node to compact, NULL when idle */
+    void (*release)(struct avl_node *);
+};
+
+#define AVL_LAZY_DEAD_RATIO 25
+#define AVL_LAZY_STEP_BUDGET 2
+#define AVL_LAZY_SCAN_RATIO 16
+
+static inline void avl_lazy_init(struct avl_lazy_root *lroot,
+        unsigned int dead_ratio, unsigned int step_budget,
+        void (*release)(struct avl_node *))
+{
+    lroot->avl_root.avl_node = NULL;
+    lroot->nr_nodes = lroot->nr_dead = 0;
+    lroot->dead_ratio = dead_ratio;
+    lroot->step_budget = step_budget ? step_budget : 1;
+    lroot->cursor = NULL;
+    lroot->release = release;
+}
+
+static inline void avl_lazy_revive(struct avl_node *node,
+        struct avl_lazy_root *lroot)
+{
+    avl_clear_dead(node);
+    lroot->nr_dead--;
+}
+
+extern void avl_lazy_insert_balance(struct avl_node *, struct avl_lazy_root *);
+extern void avl_lazy_erase(struct avl_node *, struct avl_lazy_root *);
+extern int avl_lazy_compact_start(struct avl_lazy_root *);
+extern int avl_lazy_compact_step(struct avl_lazy_root *, unsigned int budget);
+extern struct avl_node *avl_lazy_first(const struct avl_lazy_root *);
+extern struct avl_node *avl_lazy_next(const struct avl_node *);
+
+/*
+ * Relaxed balance: avl_relaxed_insert() and avl_relaxed_erase() only record
+ * the work they leave behind, avl_rebalance_step() does it later, oldest
+ * first. A pending insert is linked but not rebalanced, the tree stays a
+ * valid search tree with balance factors that ignore it until its turn. A
+ * pending erase is an AVL_DEAD node (it must not be revived) that is only
+ * unlinked once no insert is pending, so avl_erase() sees exact balance
+ * factors.
+ *
+ * A dead node may therefore share its key with a live one, which always
+ * comes after it in order. Both the insert descent and the lookup must go
+ * right on meeting a dead node of an equal key, never stop or go left
+ * there, or a lookup may miss the live node. Full AVL height bounds are back
+ * when avl_relaxed_pending() reaches zero. No locking is done here: calls
+ * must be serialized by the caller, e.g. a background thread running
+ * avl_rebalance_step() under the tree lock.
+ */
+struct avl_relaxed_root {
+    struct avl_root avl_root;
+    struct avl_node **inserted;     /* ring of nodes waiting for avl_insert_balance */
+    struct avl_node **erased;       /* ring of dead nodes waiting for avl_erase */
+    size_t size;                    /* capacity of each ring */
+    size_t ins_head, nr_inserted;
+    size_t era_head, nr_erased;
+    void (*release)(struct avl_node *);
+};
+
+#define AVL_RELAXED_DEFAULT_SIZE 1024
+
+static inline size_t avl_relaxed_pending(const struct avl_relaxed_root *rroot)
+{
+    return rroot->nr_inserted + rroot->nr_erased;
+}
+
+extern int avl_relaxed_init(struct avl_relaxed_root *, size_t size,
+                            void (*release)(struct avl_node *));
+extern void avl_relaxed_destroy(struct avl_relaxed_root *);
+extern void avl_relaxed_insert(struct avl_node *, struct avl_relaxed_root *);
+extern void avl_relaxed_erase(struct avl_node *, struct avl_relaxed_root *);
+extern size_t avl_rebalance_step(struct avl_relaxed_root *, size_t budget);
+
+/*
+ * Node variant for string and other variable-length keys: the first
+ * AVL_PREFIX_BYTES key bytes are cached next to the links as a big-endian
+ * integer, so integer order is memcmp() order. A descent compares prefixes
+ * and only dereferences the full key on a prefix tie. Keys shorter than the
+ * prefix are zero padded: the full compare must order a key before any
+ * longer key it is a prefix of.
+ */
+struct avl_prefix_node {
+    struct avl_node avl_node;
+    uint64_t avl_prefix;
+};
+
+#define AVL_PREFIX_BYTES sizeof(uint64_t)
+#define avl_prefix_entry(ptr) container_of(ptr, struct avl_prefix_node, avl_node)
+
+static inline uint64_t avl_key_prefix(const void *key, size_t len)
+{
+    unsigned char buf[AVL_PREFIX_BYTES] = { 0 };
+    uint64_t prefix;
+
+    memcpy(buf, key, len < AVL_PREFIX_BYTES ? len : AVL_PREFIX_BYTES);
+    memcpy(&prefix, buf, sizeof(prefix));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    prefix = __builtin_bswap64(prefix);
+#endif
+    return prefix;
+}
+
+/* -1, 0 or 1 without branches */
+static inline int avl_prefix_cmp(uint64_t a, uint64_t b)
+{
+    return (a > b) - (a < b);
+}
+
+/* compare the full key against the key of node, as memcmp() does */
+typedef int (*avl_prefix_cmp_t)(const void *key,
+                                const struct avl_prefix_node *node);
+
+extern struct avl_node **avl_prefix_link(struct avl_root *, uint64_t prefix,
+        const void *key, avl_prefix_cmp_t cmp, struct avl_node **parent);
+extern struct avl_prefix_node *avl_prefix_search(struct avl_root *,
+        uint64_t prefix, const void *key, avl_prefix_cmp_t cmp);
 
 #define AVL_DEFAULT_STACK_SIZE 10 // default size of the stack used in traversal functions
 
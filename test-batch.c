@@ -0,0 +1,295 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "avl-batch.h"
+
+typedef int Type;
+
+struct my_node {
+    struct avl_node avl_node;    // 树节点
+    Type key;                // 键值
+    // ... 用户自定义的数据
+};
+
+#define NTHREAD 4
+#define NELE 8192
+#define NKEY 4096    // 每个线程的键值范围
+
+static struct avl_batch_tree mytree;
+static int live[NTHREAD][NKEY];
+static unsigned long nr_alloc[NTHREAD];
+static unsigned long nr_released;
+static pthread_mutex_t released_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int my_cmp(const struct avl_node *a, const struct avl_node *b)
+{
+    Type ka = container_of(a, struct my_node, avl_node)->key;
+    Type kb = container_of(b, struct my_node, avl_node)->key;
+
+    return (ka > kb) - (ka < kb);
+}
+
+static void my_release(struct avl_node *node)
+{
+    pthread_mutex_lock(&released_lock);
+    nr_released++;
+    pthread_mutex_unlock(&released_lock);
+    free(container_of(node, struct my_node, avl_node));
+}
+
+static struct my_node *my_new(Type key)
+{
+    struct my_node *mynode;
+
+    if ((mynode = malloc(sizeof(struct my_node))) == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    /* like stale heap memory: the batch must not trust any link or flag */
+    memset(mynode, 0xff, sizeof(*mynode));
+    mynode->key = key;
+    return mynode;
+}
+
+/*
+ * 查找键值为key的节点，先查本线程的缓冲区。没找到的话，返回NULL。
+ */
+static struct my_node *my_search(struct avl_batch *batch, Type key)
+{
+    struct my_node probe;
+    struct avl_node *node;
+
+    probe.key = key;
+    node = avl_batch_search(batch, &probe.avl_node);
+    return node ? container_of(node, struct my_node, avl_node) : NULL;
+}
+
+/*
+ * Each writer owns the keys equal to its id modulo NTHREAD, so the final
+ * content is known, but all of them merge into the same parts of the tree.
+ */
+static void *writer(void *arg)
+{
+    int id = (long)arg, i;
+    struct avl_batch batch;
+    unsigned int seed = time(NULL) + id;
+    Type k;
+
+    if (avl_batch_init(&batch, &mytree, AVL_BATCH_DEFAULT_SIZE) == -1) {
+        perror("malloc");
+        exit(1);
+    }
+
+    for (i = 0; i < NELE; i++) {
+        k = rand_r(&seed) % NKEY;
+        if (rand_r(&seed) % 3) {
+            avl_batch_insert(&batch, &my_new(k * NTHREAD + id)->avl_node);
+            nr_alloc[id]++;
+            live[id][k] = 1;
+        } else {
+            avl_batch_erase(&batch, &my_new(k * NTHREAD + id)->avl_node);
+            nr_alloc[id]++;
+            live[id][k] = 0;
+        }
+        /* read your writes, flushed or not */
+        k = rand_r(&seed) % NKEY;
+        if (!my_search(&batch, k * NTHREAD + id) != !live[id][k]) {
+            printf("lookup of %d is wrong.\n", k * NTHREAD + id);
+            exit(1);
+        }
+    }
+
+    avl_batch_destroy(&batch);
+    return NULL;
+}
+
+/*
+ * Check order, parent links and balance factors. Returns the height, -1 on
+ * error.
+ */
+static int check_tree(struct avl_node *node, struct avl_node *parent,
+                      Type *last, unsigned long *nr)
+{
+    struct my_node *my;
+    int lh, rh;
+
+    if (node == NULL)
+        return 0;
+    if (avl_parent(node) != parent)
+        return -1;
+    if ((lh = check_tree(node->avl_left, node, last, nr)) < 0)
+        return -1;
+    my = container_of(node, struct my_node, avl_node);
+    if (*last >= my->key || avl_is_dead(node) ||
+        !live[my->key % NTHREAD][my->key / NTHREAD])
+        return -1;
+    *last = my->key;
+    (*nr)++;
+    if ((rh = check_tree(node->avl_right, node, last, nr)) < 0)
+        return -1;
+    if ((lh > rh && !avl_is_left_heavy(node)) ||
+        (lh < rh && !avl_is_right_heavy(node)) ||
+        (lh == rh && !avl_is_balanced(node)) ||
+        lh - rh > 1 || rh - lh > 1)
+        return -1;
+    return (lh > rh ? lh : rh) + 1;
+}
+
+/*
+ * Before the writers start, merge big runs of writer 0's keys: dense ones
+ * into the gaps of a sparse tree and a sparse one over it, so that the
+ * merged subtrees are much taller or shorter than their siblings.
+ */
+static int bulk_test(void)
+{
+    struct avl_batch batch;
+    unsigned long nr = 0;
+    Type last = -1;
+    int k, round;
+
+    if (avl_batch_init(&batch, &mytree, NKEY) == -1) {
+        perror("malloc");
+        return -1;
+    }
+    for (round = 0; round < 3; round++) {
+        for (k = 0; k < NKEY; k++) {
+            if (live[0][k] ||
+                (round == 0 && k % 64) ||
+                (round == 1 && (k < NKEY / 8 || k > NKEY / 4)) ||
+                (round == 2 && k % 3))
+                continue;
+            avl_batch_insert(&batch, &my_new(k * NTHREAD)->avl_node);
+            nr_alloc[0]++;
+            live[0][k] = 1;
+        }
+        avl_batch_flush(&batch);
+        if (check_tree(mytree.avl_root.avl_node, NULL, &last, &nr) < 0) {
+            printf("not a valid tree after bulk merge %d.\n", round);
+            return -1;
+        }
+        last = -1;
+        nr = 0;
+    }
+    avl_batch_destroy(&batch);
+    return 0;
+}
+
+/*
+ * Insert over keys already in the tree, after all writers are done: the
+ * flush must put the new nodes in place of the old ones, live.
+ */
+static int replace_test(void)
+{
+    struct avl_batch batch;
+    struct my_node *my;
+    int k, id;
+
+    if (avl_batch_init(&batch, &mytree, AVL_BATCH_DEFAULT_SIZE) == -1) {
+        perror("malloc");
+        return -1;
+    }
+    for (k = 0; k < NKEY && batch.nr < AVL_BATCH_DEFAULT_SIZE / 2; k++)
+        for (id = 0; id < NTHREAD; id++)
+            if (live[id][k]) {
+                avl_batch_insert(&batch, &my_new(k * NTHREAD + id)->avl_node);
+                nr_alloc[0]++;
+            }
+    avl_batch_flush(&batch);
+
+    for (k = 0; k < NKEY * NTHREAD; k++) {
+        if ((my = my_search(&batch, k)) == NULL)
+            continue;
+        if (avl_is_dead(&my->avl_node)) {
+            printf("replaced node of %d is dead.\n", k);
+            return -1;
+        }
+    }
+    avl_batch_destroy(&batch);
+    return 0;
+}
+
+/*
+ * A tree without release(): replaced nodes, erased nodes and probes stay
+ * with the caller, here in a static array.
+ */
+static int null_release_test(void)
+{
+    static struct my_node nodes[3 * 16];
+    struct avl_batch_tree tree;
+    struct avl_batch batch;
+    int k;
+
+    if (avl_batch_tree_init(&tree, my_cmp, NULL) == -1 ||
+        avl_batch_init(&batch, &tree, 4) == -1) {
+        perror("init");
+        return -1;
+    }
+    for (k = 0; k < 3 * 16; k++)
+        nodes[k].key = k % 16;
+    /* insert, then replace every key, then erase the odd ones */
+    for (k = 0; k < 2 * 16; k++)
+        avl_batch_insert(&batch, &nodes[k].avl_node);
+    for (k = 2 * 16 + 1; k < 3 * 16; k += 2)
+        avl_batch_erase(&batch, &nodes[k].avl_node);
+    avl_batch_flush(&batch);
+
+    for (k = 0; k < 16; k++)
+        if (my_search(&batch, k) != (k % 2 ? NULL : &nodes[16 + k])) {
+            printf("lookup of %d without release() is wrong.\n", k);
+            return -1;
+        }
+    avl_batch_destroy(&batch);
+    avl_batch_tree_destroy(&tree);
+    return 0;
+}
+
+int main()
+{
+    pthread_t tid[NTHREAD];
+    struct avl_batch batch;
+    unsigned long nr = 0, nr_live = 0, total = 0;
+    Type last = -1;
+    long i;
+    int k;
+
+    if (avl_batch_tree_init(&mytree, my_cmp, my_release) == -1) {
+        perror("pthread_rwlock_init");
+        return 1;
+    }
+    if (avl_batch_init(&batch, &mytree, 0) != -1) {
+        printf("empty batch accepted.\n");
+        return 1;
+    }
+    if (null_release_test() == -1)
+        return 1;
+    if (bulk_test() == -1)
+        return 1;
+    for (i = 0; i < NTHREAD; i++)
+        if (pthread_create(&tid[i], NULL, writer, (void *)i)) {
+            perror("pthread_create");
+            return 1;
+        }
+    for (i = 0; i < NTHREAD; i++)
+        pthread_join(tid[i], NULL);
+
+    if (replace_test() == -1)
+        return 1;
+    if (check_tree(mytree.avl_root.avl_node, NULL, &last, &nr) < 0) {
+        printf("not a valid tree.\n");
+        return 1;
+    }
+    for (i = 0; i < NTHREAD; i++) {
+        for (k = 0; k < NKEY; k++)
+            nr_live += live[i][k];
+        total += nr_alloc[i];
+    }
+    if (nr != nr_live || nr + nr_released != total) {
+        printf("%lu nodes in the tree, expected %lu.\n", nr, nr_live);
+        return 1;
+    }
+    avl_batch_tree_destroy(&mytree);
+
+    return 0;
+}
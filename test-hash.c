@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "avl-hash.h"
+
+typedef int Type;
+
+struct my_node {
+    struct avl_node avl_node;    // 树节点
+    Type key;                // 键值
+    // ... 用户自定义的数据
+};
+
+static unsigned long my_hash(Type key)
+{
+    /* keep a few low bits equal to force some long chains */
+    return (unsigned long)(key / 4) * 0x9e3779b97f4a7c15UL;
+}
+
+static int my_eq(const struct avl_node *node, const void *key)
+{
+    return container_of(node, struct my_node, avl_node)->key == *(const Type *)key;
+}
+
+/*
+ * 在树中查找键值为key的节点。没找到的话，返回NULL。
+ */
+struct my_node *my_search(struct avl_root *root, Type key)
+{
+    struct avl_node *node = root->avl_node;
+
+    while (node!=NULL)
+    {
+        struct my_node *mynode = container_of(node, struct my_node, avl_node);
+
+        if (key < mynode->key)
+            node = node->avl_left;
+        else if (key > mynode->key)
+            node = node->avl_right;
+        else
+            return mynode;
+    }
+
+    return NULL;
+}
+
+/*
+ * 通过散列索引查找键值为key的节点。没找到的话，返回NULL。
+ */
+struct my_node *my_lookup(struct avl_hroot *hroot, Type key)
+{
+    struct avl_node *node;
+
+    node = avl_hash_lookup(&hroot->avl_hash, my_hash(key), &key, my_eq);
+    return node ? container_of(node, struct my_node, avl_node) : NULL;
+}
+
+/*
+ * 将key插入到树和索引中。插入成功，返回0；失败返回-1。
+ */
+int my_insert(struct avl_hroot *hroot, Type key)
+{
+    struct my_node *mynode; // 新建结点
+    struct avl_node **tmp = &(hroot->avl_root.avl_node), *parent = NULL;
+
+    /* Figure out where to put new node */
+    while (*tmp)
+    {
+        struct my_node *my = container_of(*tmp, struct my_node, avl_node);
+
+        parent = *tmp;
+        if (key < my->key)
+            tmp = &((*tmp)->avl_left);
+        else if (key > my->key)
+            tmp = &((*tmp)->avl_right);
+        else
+            return -1;
+    }
+
+    if ((mynode=malloc(sizeof(struct my_node))) == NULL)
+        return -1;
+    mynode->key = key;
+
+    /* Add new node, rebalance tree and index it. */
+    avl_link_node(&mynode->avl_node, parent, tmp);
+    if (avl_hinsert_balance(&mynode->avl_node, my_hash(key), hroot) == -1) {
+        free(mynode);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * 删除键值为key的结点
+ */
+void my_delete(struct avl_hroot *hroot, Type key)
+{
+    struct my_node *mynode;
+
+    if ((mynode = my_lookup(hroot, key)) == NULL)
+        return ;
+
+    avl_herase(&mynode->avl_node, my_hash(key), hroot);
+    free(mynode);
+}
+
+int main()
+{
+#define NELE 32768
+#define NKEY 16384
+    int i, j, live[NKEY] = { 0 };
+    struct avl_hroot mytree;
+    struct avl_node *node;
+    Type key, last;
+
+    srand(time(NULL));
+    /* start tiny so that several resizes happen on the way */
+    if (avl_hroot_init(&mytree, 4) == -1) {
+        perror("malloc");
+        return 1;
+    }
+
+    for (i = 0; i < NELE; i++)
+    {
+        key = rand() % NKEY;
+        if (!live[key]) {
+            if (my_insert(&mytree, key) == -1) {
+                perror("malloc");
+                return 1;
+            }
+            live[key] = 1;
+        }
+        if (rand() < RAND_MAX / 3) {
+            key = rand() % NKEY;
+            my_delete(&mytree, key);
+            live[key] = 0;
+        }
+        /* index and tree agree, even in the middle of a resize */
+        for (j = 0; j < 4; j++) {
+            key = rand() % NKEY;
+            if (my_lookup(&mytree, key) != my_search(&mytree.avl_root, key) ||
+                !my_lookup(&mytree, key) != !live[key]) {
+                printf("lookup of %d is wrong.\n", key);
+                return 1;
+            }
+        }
+    }
+
+    last = -1;
+    for (node = avl_first(&mytree.avl_root); node; node = avl_next(node)) {
+        key = container_of(node, struct my_node, avl_node)->key;
+        if (key <= last || my_lookup(&mytree, key) == NULL) {
+            printf("not sorted.\n");
+            return 1;
+        }
+        last = key;
+    }
+
+    for (key = 0; key < NKEY; key++)
+        my_delete(&mytree, key);
+    if (mytree.avl_root.avl_node || mytree.avl_hash.cur.nr + mytree.avl_hash.old.nr) {
+        printf("not empty.\n");
+        return 1;
+    }
+    avl_hash_destroy(&mytree.avl_hash);
+
+    return 0;
+}
@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "avl-tree.h"
+
+typedef int Type;
+
+struct my_node {
+    struct avl_node avl_node;    // 树节点
+    Type key;                // 键值
+    // ... 用户自定义的数据
+};
+
+static unsigned long nr_alloc, nr_released;
+
+/*
+ * 查找键值为key的未删除节点。没找到的话，返回NULL。
+ */
+struct my_node *my_search(struct avl_lazy_root *lroot, Type key)
+{
+    struct avl_node *node = lroot->avl_root.avl_node;
+
+    while (node!=NULL)
+    {
+        struct my_node *mynode = container_of(node, struct my_node, avl_node);
+
+        if (key < mynode->key)
+            node = node->avl_left;
+        else if (key > mynode->key)
+            node = node->avl_right;
+        else
+            return avl_is_dead(node) ? NULL : mynode;
+    }
+
+    return NULL;
+}
+
+/*
+ * 将key插入到树中，已删除的同键节点直接复活。插入成功，返回0；失败返回-1。
+ */
+int my_insert(struct avl_lazy_root *lroot, Type key)
+{
+    struct my_node *mynode; // 新建结点
+    struct avl_node **tmp = &(lroot->avl_root.avl_node), *parent = NULL;
+
+    /* Figure out where to put new node */
+    while (*tmp)
+    {
+        struct my_node *my = container_of(*tmp, struct my_node, avl_node);
+
+        parent = *tmp;
+        if (key < my->key)
+            tmp = &((*tmp)->avl_left);
+        else if (key > my->key)
+            tmp = &((*tmp)->avl_right);
+        else if (avl_is_dead(*tmp)) {
+            avl_lazy_revive(*tmp, lroot);
+            return 0;
+        } else
+            return -1;
+    }
+
+    if ((mynode=malloc(sizeof(struct my_node))) == NULL)
+        return -1;
+    mynode->key = key;
+    nr_alloc++;
+
+    /* Add new node and rebalance tree. */
+    avl_link_node(&mynode->avl_node, parent, tmp);
+    avl_lazy_insert_balance(&mynode->avl_node, lroot);
+
+    return 0;
+}
+
+/*
+ * 删除键值为key的结点(只做标记)
+ */
+void my_delete(struct avl_lazy_root *lroot, Type key)
+{
+    struct my_node *mynode;
+
+    if ((mynode = my_search(lroot, key)) == NULL)
+        return ;
+
+    avl_lazy_erase(&mynode->avl_node, lroot);
+}
+
+static void my_release(struct avl_node *node)
+{
+    nr_released++;
+    free(container_of(node, struct my_node, avl_node));
+}
+
+/*
+ * Check order, parent links and balance factors, counting dead nodes.
+ * Returns the height, -1 on error.
+ */
+static int check_tree(struct avl_node *node, struct avl_node *parent,
+                      unsigned long *nr, unsigned long *nr_dead)
+{
+    int lh, rh;
+
+    if (node == NULL)
+        return 0;
+    if (avl_parent(node) != parent)
+        return -1;
+    if ((lh = check_tree(node->avl_left, node, nr, nr_dead)) < 0 ||
+        (rh = check_tree(node->avl_right, node, nr, nr_dead)) < 0)
+        return -1;
+    if ((lh > rh && !avl_is_left_heavy(node)) ||
+        (lh < rh && !avl_is_right_heavy(node)) ||
+        (lh == rh && !avl_is_balanced(node)) ||
+        lh - rh > 1 || rh - lh > 1)
+        return -1;
+    (*nr)++;
+    if (avl_is_dead(node))
+        (*nr_dead)++;
+    return (lh > rh ? lh : rh) + 1;
+}
+
+int main()
+{
+#define NELE 8192
+#define NKEY 2048
+    int i, live[NKEY] = { 0 }, nr_live = 0;
+    struct avl_lazy_root mytree;
+    struct avl_node *node;
+    unsigned long nr, nr_dead;
+    Type key, last;
+
+    srand(time(NULL));
+    avl_lazy_init(&mytree, AVL_LAZY_DEAD_RATIO, AVL_LAZY_STEP_BUDGET, my_release);
+
+    for (i = 0; i < NELE; i++)
+    {
+        key = rand() % NKEY;
+        if (my_insert(&mytree, key) == 0) {
+            live[key] = 1;
+            nr_live++;
+        }
+        /* delete-heavy bursts */
+        if ((i / 512) % 2) {
+            key = rand() % NKEY;
+            if (live[key]) {
+                my_delete(&mytree, key);
+                live[key] = 0;
+                nr_live--;
+            }
+        }
+        /* small steps still keep up with the bursts */
+        if (mytree.nr_nodes > 64 &&
+            mytree.nr_dead * 100 > mytree.nr_nodes * AVL_LAZY_DEAD_RATIO * 2) {
+            printf("%lu dead nodes out of %lu.\n", mytree.nr_dead, mytree.nr_nodes);
+            return 1;
+        }
+    }
+
+    nr = nr_dead = 0;
+    if (check_tree(mytree.avl_root.avl_node, NULL, &nr, &nr_dead) < 0) {
+        printf("not a valid tree.\n");
+        return 1;
+    }
+    if (nr != mytree.nr_nodes || nr_dead != mytree.nr_dead ||
+        nr - nr_dead != nr_live) {
+        printf("bad counters.\n");
+        return 1;
+    }
+
+    /* iteration and lookups only see live nodes */
+    last = -1;
+    for (node = avl_lazy_first(&mytree); node; node = avl_lazy_next(node)) {
+        key = container_of(node, struct my_node, avl_node)->key;
+        if (key <= last || !live[key]) {
+            printf("not sorted.\n");
+            return 1;
+        }
+        last = key;
+        nr_live--;
+    }
+    if (nr_live) {
+        printf("%d live nodes not visited.\n", nr_live);
+        return 1;
+    }
+    for (i = 0; i < NKEY; i++)
+        if (!my_search(&mytree, i) != !live[i]) {
+            printf("lookup of %d is wrong.\n", i);
+            return 1;
+        }
+
+    if (!nr_released) {
+        printf("no compaction during the bursts.\n");
+        return 1;
+    }
+
+    /* finish off at a quiet point: a running pass misses nodes behind it */
+    if (mytree.nr_dead && !avl_lazy_compact_start(&mytree)) {
+        printf("compaction not started.\n");
+        return 1;
+    }
+    do {
+        while (avl_lazy_compact_step(&mytree, AVL_LAZY_STEP_BUDGET))
+            ;
+    } while (avl_lazy_compact_start(&mytree));
+    if (mytree.nr_dead) {
+        printf("dead nodes left.\n");
+        return 1;
+    }
+    if (nr_released + mytree.nr_nodes != nr_alloc) {
+        printf("leaked %lu nodes.\n", nr_alloc - nr_released - mytree.nr_nodes);
+        return 1;
+    }
+
+    /* a zero step budget must still reclaim dead nodes */
+    avl_lazy_init(&mytree, AVL_LAZY_DEAD_RATIO, 0, my_release);
+    for (i = 0; i < NKEY; i++)
+        my_insert(&mytree, i);
+    for (i = 0; i < NKEY; i++)
+        my_delete(&mytree, i);
+    if (mytree.nr_nodes == NKEY) {
+        printf("no compaction with a zero step budget.\n");
+        return 1;
+    }
+
+    return 0;
+}
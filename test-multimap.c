@@ -0,0 +1,193 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "avl-tree.h"
+
+typedef int Type;
+
+struct my_node {
+    struct avl_multi_node avl_node;    // 多重映射节点
+    Type key;                // 键值
+    // ... 用户自定义的数据
+};
+
+/*
+ * 查找键值为key的树节点(即该键的第一个条目)。没找到的话，返回NULL。
+ */
+struct my_node *my_search(struct avl_root *root, Type key)
+{
+    struct avl_node *node = root->avl_node;
+
+    while (node!=NULL)
+    {
+        struct my_node *mynode = container_of(avl_multi_entry(node), struct my_node, avl_node);
+
+        if (key < mynode->key)
+            node = node->avl_left;
+        else if (key > mynode->key)
+            node = node->avl_right;
+        else
+            return mynode;
+    }
+
+    return NULL;
+}
+
+/*
+ * 将key插入到多重映射中，相同的键挂在已有节点上。插入成功，返回0；失败返回-1。
+ */
+int my_insert(struct avl_root *root, Type key)
+{
+    struct my_node *mynode; // 新建结点
+    struct avl_node **tmp = &(root->avl_node), *parent = NULL;
+
+    if ((mynode=malloc(sizeof(struct my_node))) == NULL)
+        return -1;
+    mynode->key = key;
+
+    /* Figure out where to put new node */
+    while (*tmp)
+    {
+        struct my_node *my = container_of(avl_multi_entry(*tmp), struct my_node, avl_node);
+
+        parent = *tmp;
+        if (key < my->key)
+            tmp = &((*tmp)->avl_left);
+        else if (key > my->key)
+            tmp = &((*tmp)->avl_right);
+        else {
+            /* Duplicate: no rebalancing needed. */
+            avl_multi_add_dup(&mynode->avl_node, &my->avl_node);
+            return 0;
+        }
+    }
+
+    /* Add new node and rebalance tree. */
+    avl_multi_link_node(&mynode->avl_node, parent, tmp);
+    avl_insert_balance(&mynode->avl_node.avl_node, root);
+
+    return 0;
+}
+
+/*
+ * 删除键值为key的第n个条目，返回0；不存在则返回-1
+ */
+int my_delete(struct avl_root *root, Type key, int n)
+{
+    struct my_node *mynode;
+    struct avl_multi_node *pos;
+
+    if ((mynode = my_search(root, key)) == NULL)
+        return -1;
+    avl_multi_for_each(pos, &mynode->avl_node)
+        if (n-- == 0)
+            break;
+    if (pos == NULL)
+        return -1;
+
+    avl_multi_erase(pos, root);
+    free(container_of(pos, struct my_node, avl_node));
+    return 0;
+}
+
+/*
+ * Check keys are distinct and sorted, balance factors are right and every
+ * chain holds entries of its own key only. Returns the height, -1 on error.
+ */
+static int check_tree(struct avl_node *node, struct avl_node *parent,
+                      Type *last, int *cnt)
+{
+    struct my_node *my;
+    struct avl_multi_node *pos;
+    int lh, rh;
+
+    if (node == NULL)
+        return 0;
+    if (avl_parent(node) != parent)
+        return -1;
+    if ((lh = check_tree(node->avl_left, node, last, cnt)) < 0)
+        return -1;
+
+    my = container_of(avl_multi_entry(node), struct my_node, avl_node);
+    if (*last >= my->key)
+        return -1;
+    *last = my->key;
+    avl_multi_for_each(pos, &my->avl_node) {
+        if (container_of(pos, struct my_node, avl_node)->key != my->key)
+            return -1;
+        if (pos != &my->avl_node && !avl_is_duplicate(&pos->avl_node))
+            return -1;
+        cnt[my->key]++;
+    }
+
+    if ((rh = check_tree(node->avl_right, node, last, cnt)) < 0)
+        return -1;
+    if (lh - rh > 1 || rh - lh > 1)
+        return -1;
+    if ((lh > rh && !avl_is_left_heavy(node)) ||
+        (lh < rh && !avl_is_right_heavy(node)) ||
+        (lh == rh && !avl_is_balanced(node)))
+        return -1;
+    return (lh > rh ? lh : rh) + 1;
+}
+
+int main()
+{
+#define NELE 4096
+#define NKEY 64
+    int i, h, distinct;
+    struct avl_root mytree = { NULL };
+    int cnt[NKEY] = { 0 }, seen[NKEY];
+    Type key, last;
+
+    srand(time(NULL));
+
+    for (i = 0; i < NELE; i++)
+    {
+        /* skewed: half of the entries go to a few hot keys */
+        key = rand() % (rand() % 2 ? 4 : NKEY);
+        if (my_insert(&mytree, key) == -1) {
+            perror("malloc");
+            return 1;
+        }
+        cnt[key]++;
+        if (rand() < RAND_MAX / 3) {
+            key = rand() % NKEY;
+            if (cnt[key] && my_delete(&mytree, key, rand() % cnt[key]) == 0)
+                cnt[key]--;
+        }
+    }
+
+    for (i = 0; i < NKEY; i++)
+        seen[i] = 0;
+    last = -1;
+    if ((h = check_tree(mytree.avl_node, NULL, &last, seen)) < 0) {
+        printf("not a valid tree.\n");
+        return 1;
+    }
+    for (i = 0, distinct = 0; i < NKEY; i++) {
+        if (seen[i] != cnt[i]) {
+            printf("key %d: %d entries, expected %d.\n", i, seen[i], cnt[i]);
+            return 1;
+        }
+        distinct += cnt[i] != 0;
+    }
+    /* AVL bound on the distinct keys: h < 1.44 log2(n + 2) */
+    for (i = 0; (1 << i) < distinct + 2; i++)
+        ;
+    if (h * 100 > 144 * i) {
+        printf("height %d too large for %d keys.\n", h, distinct);
+        return 1;
+    }
+
+    /* drain everything, duplicates first and tree nodes last */
+    for (i = 0; i < NKEY; i++)
+        while (cnt[i])
+            my_delete(&mytree, i, --cnt[i]);
+    if (mytree.avl_node != NULL) {
+        printf("tree not empty.\n");
+        return 1;
+    }
+
+    return 0;
+}
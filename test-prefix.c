@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "avl-tree.h"
+
+struct my_node {
+    struct avl_prefix_node avl_node;    // 带键前缀的树节点
+    char *key;                // 键值(字符串)
+    // ... 用户自定义的数据
+};
+
+static int my_cmp(const void *key, const struct avl_prefix_node *node)
+{
+    return strcmp(key, container_of(node, struct my_node, avl_node)->key);
+}
+
+/*
+ * 查找键值为key的节点。没找到的话，返回NULL。
+ */
+struct my_node *my_search(struct avl_root *root, const char *key)
+{
+    struct avl_prefix_node *node;
+
+    node = avl_prefix_search(root, avl_key_prefix(key, strlen(key)), key, my_cmp);
+    return node ? container_of(node, struct my_node, avl_node) : NULL;
+}
+
+/*
+ * 将key插入到树中。插入成功，返回0；失败返回-1。
+ */
+int my_insert(struct avl_root *root, const char *key)
+{
+    struct my_node *mynode; // 新建结点
+    struct avl_node **link, *parent;
+    uint64_t prefix = avl_key_prefix(key, strlen(key));
+
+    link = avl_prefix_link(root, prefix, key, my_cmp, &parent);
+    if (*link)
+        return -1;
+
+    if ((mynode=malloc(sizeof(struct my_node))) == NULL)
+        return -1;
+    if ((mynode->key = strdup(key)) == NULL) {
+        free(mynode);
+        return -1;
+    }
+    mynode->avl_node.avl_prefix = prefix;
+
+    /* Add new node and rebalance tree. */
+    avl_link_node(&mynode->avl_node.avl_node, parent, link);
+    avl_insert_balance(&mynode->avl_node.avl_node, root);
+
+    return 0;
+}
+
+/*
+ * 删除键值为key的结点
+ */
+void my_delete(struct avl_root *root, const char *key)
+{
+    struct my_node *mynode;
+
+    if ((mynode = my_search(root, key)) == NULL)
+        return ;
+
+    avl_erase(&mynode->avl_node.avl_node, root);
+    free(mynode->key);
+    free(mynode);
+}
+
+/* path-like keys sharing long prefixes, some shorter than the prefix */
+static void rand_key(char *buf)
+{
+    static const char *dirs[] = { "/", "/usr/", "/usr/lib/", "/usr/local/", "a" };
+    size_t len;
+    int n = rand() % 6;
+
+    strcpy(buf, dirs[rand() % 5]);
+    for (len = strlen(buf); n--; len++)
+        buf[len] = 'a' + rand() % 3;
+    buf[len] = '\0';
+}
+
+int main()
+{
+#define NELE 4096
+    int i, j, n;
+    struct avl_root mytree = { NULL };
+    struct avl_node *node;
+    char keys[NELE][32], *last;
+
+    srand(time(NULL));
+
+    for (i = 0, n = 0; i < NELE; i++)
+    {
+        rand_key(keys[n]);
+        j = my_insert(&mytree, keys[n]);
+        if (j == 0)
+            n++;
+        else if (my_search(&mytree, keys[n]) == NULL) {
+            perror("malloc");
+            return 1;
+        }
+    }
+
+    for (i = 0; i < n; i++)
+        if (my_search(&mytree, keys[i]) == NULL) {
+            printf("%s not found.\n", keys[i]);
+            return 1;
+        }
+    for (i = 0; i < n; i += 2)
+        my_delete(&mytree, keys[i]);
+    for (i = 0; i < n; i++)
+        if (!my_search(&mytree, keys[i]) != (i % 2 == 0)) {
+            printf("lookup of %s is wrong.\n", keys[i]);
+            return 1;
+        }
+
+    last = "";
+    for (node = avl_first(&mytree); node; node = avl_next(node)) {
+        struct my_node *my = container_of(avl_prefix_entry(node), struct my_node, avl_node);
+
+        if (strcmp(last, my->key) >= 0) {
+            printf("not sorted.\n");
+            return 1;
+        }
+        last = my->key;
+    }
+
+    return 0;
+}
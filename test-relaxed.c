@@ -0,0 +1,187 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "avl-tree.h"
+
+typedef int Type;
+
+struct my_node {
+    struct avl_node avl_node;    // 树节点
+    Type key;                // 键值
+    // ... 用户自定义的数据
+};
+
+static unsigned long nr_alloc, nr_released;
+
+/*
+ * 查找键值为key的未删除节点。没找到的话，返回NULL。
+ * 待删除的同键节点排在新节点之前，所以遇到时继续向右找。
+ */
+struct my_node *my_search(struct avl_relaxed_root *rroot, Type key)
+{
+    struct avl_node *node = rroot->avl_root.avl_node;
+
+    while (node!=NULL)
+    {
+        struct my_node *mynode = container_of(node, struct my_node, avl_node);
+
+        if (key < mynode->key)
+            node = node->avl_left;
+        else if (key > mynode->key || avl_is_dead(node))
+            node = node->avl_right;
+        else
+            return mynode;
+    }
+
+    return NULL;
+}
+
+/*
+ * 将key插入到树中，只链接不平衡。插入成功，返回0；失败返回-1。
+ */
+int my_insert(struct avl_relaxed_root *rroot, Type key)
+{
+    struct my_node *mynode; // 新建结点
+    struct avl_node **tmp = &(rroot->avl_root.avl_node), *parent = NULL;
+
+    /* Figure out where to put new node */
+    while (*tmp)
+    {
+        struct my_node *my = container_of(*tmp, struct my_node, avl_node);
+
+        parent = *tmp;
+        if (key < my->key)
+            tmp = &((*tmp)->avl_left);
+        else if (key > my->key || avl_is_dead(*tmp))
+            tmp = &((*tmp)->avl_right);
+        else
+            return -1;
+    }
+
+    if ((mynode=malloc(sizeof(struct my_node))) == NULL)
+        return -1;
+    mynode->key = key;
+    nr_alloc++;
+
+    /* Add new node, balancing is deferred. */
+    avl_link_node(&mynode->avl_node, parent, tmp);
+    avl_relaxed_insert(&mynode->avl_node, rroot);
+
+    return 0;
+}
+
+/*
+ * 删除键值为key的结点(延迟到avl_rebalance_step)
+ */
+void my_delete(struct avl_relaxed_root *rroot, Type key)
+{
+    struct my_node *mynode;
+
+    if ((mynode = my_search(rroot, key)) == NULL)
+        return ;
+
+    avl_relaxed_erase(&mynode->avl_node, rroot);
+}
+
+static void my_release(struct avl_node *node)
+{
+    nr_released++;
+    free(container_of(node, struct my_node, avl_node));
+}
+
+/*
+ * Check parent links and in-order keys, and the balance factors too when
+ * balanced is set. Returns the height, -1 on error.
+ */
+static int check_tree(struct avl_node *node, struct avl_node *parent,
+                      int balanced, Type *last, unsigned long *nr)
+{
+    struct my_node *my;
+    int lh, rh;
+
+    if (node == NULL)
+        return 0;
+    if (avl_parent(node) != parent)
+        return -1;
+    if ((lh = check_tree(node->avl_left, node, balanced, last, nr)) < 0)
+        return -1;
+    my = container_of(node, struct my_node, avl_node);
+    if (*last > my->key)
+        return -1;
+    *last = my->key;
+    (*nr)++;
+    if ((rh = check_tree(node->avl_right, node, balanced, last, nr)) < 0)
+        return -1;
+    if (balanced &&
+        ((lh > rh && !avl_is_left_heavy(node)) ||
+         (lh < rh && !avl_is_right_heavy(node)) ||
+         (lh == rh && !avl_is_balanced(node)) ||
+         lh - rh > 1 || rh - lh > 1))
+        return -1;
+    return (lh > rh ? lh : rh) + 1;
+}
+
+int main()
+{
+#define NROUND 8
+#define NBURST 2048
+#define NKEY 4096
+    int i, j, live[NKEY] = { 0 };
+    struct avl_relaxed_root mytree;
+    unsigned long nr;
+    Type key, last;
+
+    srand(time(NULL));
+    if (avl_relaxed_init(&mytree, 0, my_release) != -1) {
+        printf("empty rings accepted.\n");
+        return 1;
+    }
+    if (avl_relaxed_init(&mytree, 256, my_release) == -1) {
+        perror("malloc");
+        return 1;
+    }
+
+    for (j = 0; j < NROUND; j++) {
+        /* write burst: link and unlink only, steps only when the rings fill */
+        for (i = 0; i < NBURST; i++)
+        {
+            key = rand() % NKEY;
+            if (!live[key] && my_insert(&mytree, key) == 0)
+                live[key] = 1;
+            key = rand() % NKEY;
+            if (live[key] && rand() < RAND_MAX / 2) {
+                my_delete(&mytree, key);
+                live[key] = 0;
+            }
+        }
+        last = -1;
+        nr = 0;
+        if (check_tree(mytree.avl_root.avl_node, NULL, 0, &last, &nr) < 0) {
+            printf("not a search tree.\n");
+            return 1;
+        }
+        for (i = 0; i < NKEY; i++)
+            if (!my_search(&mytree, i) != !live[i]) {
+                printf("lookup of %d is wrong.\n", i);
+                return 1;
+            }
+
+        /* quiet point: catch up in small steps */
+        while (avl_rebalance_step(&mytree, 16))
+            ;
+        last = -1;
+        nr = 0;
+        if (check_tree(mytree.avl_root.avl_node, NULL, 1, &last, &nr) < 0) {
+            printf("not balanced after catching up.\n");
+            return 1;
+        }
+        if (nr != nr_alloc - nr_released) {
+            printf("%lu nodes in the tree, expected %lu.\n",
+                   nr, nr_alloc - nr_released);
+            return 1;
+        }
+    }
+    avl_relaxed_destroy(&mytree);
+
+    return 0;
+}